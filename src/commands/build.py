@@ -1,10 +1,14 @@
 """doscc build - compile and link a DOS project."""
 
+import os
 import sys
 import time
 from pathlib import Path
 
-from config import load_global_config, load_project_config, find_project_root
+from config import (
+    load_global_config, load_project_config, find_project_root, LIBS_DIR,
+)
+from libbuild import LibBuildOptions, variant_for, ensure_current
 from workspace import Workspace
 from xt import XTRunner, BuildError
 from targets import create_target
@@ -12,6 +16,7 @@ from targets import create_target
 
 def run(args: list[str]) -> int:
     verbose = "-v" in args or "--verbose" in args
+    sizes = "--sizes" in args
 
     # Find project
     project_root = find_project_root()
@@ -42,9 +47,27 @@ def run(args: list[str]) -> int:
         print(f"run 'doscc setup' to configure SDKs", file=sys.stderr)
         return 1
 
-    # Prepare workspace
     start = time.time()
     ws = Workspace(project_root, project_cfg, global_cfg)
+    runner = XTRunner(global_cfg.xt_path, ws.build_dir, verbose=verbose)
+    target = create_target(project_cfg, runner, ws.build_dir)
+
+    # Rebuild stale doscc libraries (and their dependencies) before linking,
+    # only those the target links
+    doscc_libs = [lib.upper().removesuffix(".LIB")
+                  for lib in target.linked_libraries()
+                  if (LIBS_DIR / lib.lower().removesuffix(".lib")).is_dir()]
+    if doscc_libs:
+        variants = [variant_for(target.lib_model())]
+        if project_cfg.compiler.optimization == "speed":
+            variants.append(variant_for(target.lib_model(), speed=True))
+        opts = LibBuildOptions(verbose=verbose, jobs=os.cpu_count() or 1,
+                               variants=variants)
+        if ensure_current(doscc_libs, variants, opts) != 0:
+            print("error: failed to rebuild libraries", file=sys.stderr)
+            return 1
+
+    # Prepare workspace
     sources = ws.prepare()
 
     if not sources:
@@ -58,14 +81,17 @@ def run(args: list[str]) -> int:
         print()
 
     # Build
-    runner = XTRunner(global_cfg.xt_path, ws.build_dir, verbose=verbose)
-    target = create_target(project_cfg, runner, ws.build_dir)
-
     try:
         output = target.build(sources, project_root)
+        # The report reads the objects, libraries and .MAP in the workspace
+        report = target.size_report() if sizes else []
         ws.cleanup()
         elapsed = time.time() - start
         print(f"built {output.name} ({elapsed:.1f}s)")
+        if report:
+            print(f"\nsize report for {output.name}:")
+            for line in report:
+                print(line)
         return 0
     except BuildError as e:
         print(f"\nerror: {e}", file=sys.stderr)
@@ -1,18 +1,18 @@
 """doscc lib - manage pre-built libraries."""
 
 import os
-import shutil
 import sys
-import tempfile
-import time
 from pathlib import Path
 
-from config import GLOBAL_CONFIG_DIR, load_global_config
-from xt import XTRunner, BuildError
+import libcache
+import libgraph
+from config import LIBS_DIR
+from libbuild import (
+    LIB_MODELS, LibVariant, LibBuildOptions, build_lib, build_all,
+    stale_reason,
+)
 
 
-LIBS_DIR = GLOBAL_CONFIG_DIR / "libs"
-
 USAGE = """\
 doscc lib - manage pre-built libraries
 
@@ -22,9 +22,20 @@ subcommands:
   list              List installed libraries
   build [name]      Build a library (or all libraries)
   new <name>        Create a new library from template
+  graph [--dot]     Show library dependencies, build order and critical path
+  cache list        Show the library build cache
+  cache export <p>  Write the cache to a .tar.gz/.tar or a directory
+  cache import <p>  Merge a cache tarball or directory into the local cache
+  cache clear       Empty the library build cache
 
 options:
   -v, --verbose     Show detailed build output
+  -j N, --jobs=N    Compile up to N modules at once (default: CPU count)
+  --rebuild         Ignore saved module state and rebuild from scratch
+  --model=M[,M]     Build only these models (small,medium,compact,large)
+  --speed           Also build /Ox variants (e.g. SVIDEOX.LIB)
+  --no-cache        Don't restore from or store into the build cache
+  -DNAME[=VALUE]    Define NAME for CL and MASM (e.g. -DVID_C_LOOPS)
 """
 
 
@@ -48,10 +59,18 @@ def _list_libs() -> int:
 
         has_source = (any(lib_dir.glob("*.C")) or any(lib_dir.glob("*.c"))
                       or any(lib_dir.glob("*.ASM")) or any(lib_dir.glob("*.asm")))
-        has_lib = any(lib_dir.glob("*.LIB")) or any(lib_dir.glob("*.lib"))
-
-        if has_lib:
-            status = "built"
+        built = sorted(p.name.upper() for p in lib_dir.iterdir()
+                       if p.suffix.upper() == ".LIB")
+
+        # Flag variants whose sources or dependencies changed since built
+        stale = {v.lib_name(name) for m in LIB_MODELS for speed in (False, True)
+                 for v in [LibVariant(m, speed)]
+                 if v.lib_name(name) in built and stale_reason(name, v)}
+        if built:
+            shown = [f"{b}*" if b in stale else b for b in built]
+            status = f"built ({', '.join(shown)})"
+            if stale:
+                status += " - * stale, run 'doscc lib build'"
         elif has_source:
             status = "source only (run 'doscc lib build')"
         else:
@@ -66,228 +85,53 @@ def _list_libs() -> int:
 
 
 # ======================================================================
-# Build
+# Build options
 # ======================================================================
 
-def _build_lib(name: str, verbose: bool) -> int:
-    """Build a single library."""
-    lib_dir = LIBS_DIR / name.lower()
-    if not lib_dir.exists():
-        print(f"error: library '{name}' not found in {LIBS_DIR}", file=sys.stderr)
-        return 1
-
-    # Find source files (.C and .ASM)
-    c_sources = sorted(lib_dir.glob("*.C"))
-    if not c_sources:
-        c_sources = sorted(lib_dir.glob("*.c"))
-    asm_sources = sorted(lib_dir.glob("*.ASM"))
-    if not asm_sources:
-        asm_sources = sorted(lib_dir.glob("*.asm"))
-    sources = c_sources + asm_sources
-
-    # Header-only libraries: have .H files but no compilable sources
-    if not sources:
-        has_headers = any(lib_dir.glob("*.H")) or any(lib_dir.glob("*.h"))
-        if has_headers:
-            print(f"{name.upper()}: header-only, nothing to build")
-            return 0
-        print(f"error: no .C or .ASM source files in {lib_dir}", file=sys.stderr)
-        return 1
-
-    # Check DEPS file — all dependencies must be built first
-    deps_file = lib_dir / "DEPS"
-    if deps_file.exists():
-        for line in deps_file.read_text().splitlines():
-            dep = line.strip()
-            if not dep or dep.startswith("#"):
-                continue
-            dep_dir = LIBS_DIR / dep.lower()
-            dep_lib = dep.upper() + ".LIB"
-            if not dep_dir.exists() or not (dep_dir / dep_lib).exists():
-                print(f"error: {name.upper()} depends on {dep.upper()} "
-                      f"which is not built yet", file=sys.stderr)
-                print(f"build it first: doscc lib build {dep}", file=sys.stderr)
-                return 1
-
-    # Load global config for toolchain
-    global_cfg = load_global_config()
-    if "msc50" not in global_cfg.toolchains:
-        print("error: toolchain 'msc50' not configured", file=sys.stderr)
-        print("run 'doscc setup' first", file=sys.stderr)
-        return 1
-
-    tc = global_cfg.toolchains["msc50"]
-    lib_name = name.upper() + ".LIB"
-
-    start = time.time()
-
-    # Create temp workspace
-    with tempfile.TemporaryDirectory() as tmpdir:
-        build_dir = Path(tmpdir)
-
-        # Symlink toolchain BIN/
-        os.symlink(tc.path / "BIN", build_dir / "BIN")
-
-        # Merge includes: toolchain headers + library's own headers
-        inc_dir = build_dir / "INCLUDE"
-        inc_dir.mkdir()
-        tc_inc = tc.path / "INCLUDE"
-        if tc_inc.exists():
-            for item in tc_inc.iterdir():
-                os.symlink(item, inc_dir / item.name)
-        for h in lib_dir.iterdir():
-            if h.suffix.upper() == ".H":
-                dest = inc_dir / h.name.upper()
-                if not dest.exists():
-                    os.symlink(h, dest)
-
-        # Cross-library headers: symlink .H from all other installed libs
-        if LIBS_DIR.exists():
-            for other_lib in LIBS_DIR.iterdir():
-                if other_lib.is_dir() and other_lib != lib_dir:
-                    for h in other_lib.iterdir():
-                        if h.suffix.upper() == ".H":
-                            dest = inc_dir / h.name.upper()
-                            if not dest.exists():
-                                os.symlink(h, dest)
-
-        # Copy source files into SRC/
-        src_dir = build_dir / "SRC"
-        src_dir.mkdir()
-        for src in sources:
-            shutil.copy2(src, src_dir / src.name.upper())
-
-        # LIB/ for output
-        lib_out_dir = build_dir / "LIB"
-        lib_out_dir.mkdir()
-
-        runner = XTRunner(global_cfg.xt_path, build_dir, verbose=verbose)
-
-        # Compile each source file
-        obj_files = []
-        for src in sources:
-            dos_name = src.name.upper()
-            base, ext = dos_name.rsplit(".", 1)
-            obj_name = base + ".OBJ"
-
-            try:
-                if ext == "ASM":
-                    # MASM: /ML = case-sensitive (C linkage)
-                    args = f"/ML /IINCLUDE SRC\\{dos_name},SRC\\{obj_name},NUL,NUL;"
-                    runner.run_checked("BIN\\MASM.EXE", args, tool_name="MASM.EXE")
-                else:
-                    args = f"/c /AS /Zl /Gs /IINCLUDE /FoSRC\\ SRC\\{dos_name}"
-                    runner.run_checked("BIN\\CL.EXE", args, tool_name="CL.EXE")
-            except BuildError as e:
-                print(f"\nerror: compiling {dos_name}: {e}", file=sys.stderr)
-                if e.output:
-                    print(e.output, file=sys.stderr)
-                return 1
-            obj_files.append(f"SRC\\{obj_name}")
-
-        # Create .LIB using LIB.EXE
-        # Format: LIB libname +obj1 +obj2 ;
-        ops = " ".join(f"+{obj}" for obj in obj_files)
-        args = f"LIB\\{lib_name} {ops};"
-
-        try:
-            runner.run_checked("BIN\\LIB.EXE", args, tool_name="LIB.EXE")
-        except BuildError as e:
-            print(f"\nerror: creating {lib_name}: {e}", file=sys.stderr)
-            if e.output:
-                print(e.output, file=sys.stderr)
-            return 1
-
-        # Copy built .LIB back to library directory
-        built_lib = build_dir / "LIB" / lib_name
-        if not built_lib.exists():
-            print(f"error: {lib_name} was not created", file=sys.stderr)
-            return 1
-
-        shutil.copy2(built_lib, lib_dir / lib_name)
-
-    elapsed = time.time() - start
-    print(f"built {lib_name} ({elapsed:.1f}s)")
-    return 0
-
-
-def _topo_sort_libs():
-    """Topologically sort library directories by DEPS files."""
-    if not LIBS_DIR.exists():
-        return []
-
-    # Collect all library names
-    libs = {}
-    for lib_dir in sorted(LIBS_DIR.iterdir()):
-        if not lib_dir.is_dir():
+def _parse_jobs(args: list[str]) -> int | None:
+    """Return the module concurrency from -jN / -j N / --jobs=N (default:
+    CPU count), or None on a bad count."""
+    for i, a in enumerate(args):
+        if a.startswith("--jobs="):
+            value = a[len("--jobs="):]
+        elif a.startswith("-j") and len(a) > 2:
+            value = a[2:]
+        elif a == "-j":
+            value = args[i + 1] if i + 1 < len(args) else ""
+        else:
             continue
-        name = lib_dir.name.lower()
-        deps = []
-        deps_file = lib_dir / "DEPS"
-        if deps_file.exists():
-            for line in deps_file.read_text().splitlines():
-                dep = line.strip().lower()
-                if dep and not dep.startswith("#"):
-                    deps.append(dep)
-        libs[name] = deps
-
-    # Kahn's algorithm for topological sort
-    in_degree = {name: 0 for name in libs}
-    for name, deps in libs.items():
-        for dep in deps:
-            if dep in in_degree:
-                in_degree[name] += 1
-
-    queue = sorted([n for n, d in in_degree.items() if d == 0])
-    order = []
-    while queue:
-        node = queue.pop(0)
-        order.append(node)
-        for name, deps in libs.items():
-            if node in deps:
-                in_degree[name] -= 1
-                if in_degree[name] == 0:
-                    queue.append(name)
-                    queue.sort()
-
-    # Append any remaining (circular deps) at the end
-    for name in sorted(libs):
-        if name not in order:
-            order.append(name)
-
-    return order
-
-
-def _build_all(verbose: bool) -> int:
-    """Build all libraries in dependency order."""
-    if not LIBS_DIR.exists():
-        print("no libraries installed")
-        print("run 'doscc setup' to install library sources")
-        return 0
-
-    order = _topo_sort_libs()
-    if not order:
-        print("no libraries found")
-        return 0
-
-    built = 0
-    rc = 0
-    for name in order:
-        lib_dir = LIBS_DIR / name
-        has_source = (any(lib_dir.glob("*.C")) or any(lib_dir.glob("*.c"))
-                      or any(lib_dir.glob("*.ASM")) or any(lib_dir.glob("*.asm")))
-        has_headers = any(lib_dir.glob("*.H")) or any(lib_dir.glob("*.h"))
-        if has_source or has_headers:
-            result = _build_lib(name, verbose)
-            if result != 0:
-                rc = result
-            else:
-                built += 1
-
-    if built == 0 and rc == 0:
-        print("no libraries with source files found")
-
-    return rc
+        if not value.isdigit():
+            print(f"error: bad job count '{value}' for {a}", file=sys.stderr)
+            return None
+        return max(1, int(value))
+    return os.cpu_count() or 1
+
+
+def _parse_variants(args: list[str]) -> list[LibVariant] | None:
+    """Return variants from --model=... / --speed / -D..., or None on a bad
+    model."""
+    models = list(LIB_MODELS)
+    for a in args:
+        if a.startswith("--model="):
+            models = [m.strip().lower() for m in a[len("--model="):].split(",")
+                      if m.strip()]
+            if not models:
+                print(f"error: no model given in '{a}' "
+                      f"(valid: {', '.join(LIB_MODELS)})", file=sys.stderr)
+                return None
+            for m in models:
+                if m not in LIB_MODELS:
+                    print(f"error: unknown model '{m}' "
+                          f"(valid: {', '.join(LIB_MODELS)})", file=sys.stderr)
+                    return None
+
+    # -DNAME[=VALUE] goes to both CL.EXE and MASM.EXE, e.g. -DVID_C_LOOPS
+    defines = tuple(a[2:] for a in args if a.startswith("-D") and len(a) > 2)
+
+    variants = [LibVariant(m, defines=defines) for m in models]
+    if "--speed" in args:
+        variants += [LibVariant(m, speed=True, defines=defines) for m in models]
+    return variants
 
 
 # ======================================================================
@@ -392,6 +236,92 @@ def _new_lib(name: str) -> int:
     return 0
 
 
+# ======================================================================
+# Build cache
+# ======================================================================
+
+def _cache_cmd(args: list[str]) -> int:
+    """doscc lib cache [list|export <path>|import <path>|clear]"""
+    sub = args[0] if args else "list"
+
+    if sub == "list":
+        found = libcache.entries()
+        if not found:
+            print(f"library cache is empty ({libcache.CACHE_DIR})")
+            return 0
+        print(f"library cache: {libcache.CACHE_DIR}")
+        for entry in found:
+            libs = ", ".join(sorted(f.name for f in entry.iterdir()
+                                    if f.suffix.upper() == ".LIB"))
+            print(f"  {entry.name[:12]}  {libs}")
+        print(f"{len(found)} entr{'y' if len(found) == 1 else 'ies'}")
+        return 0
+
+    elif sub in ("export", "import"):
+        if len(args) < 2:
+            print(f"error: usage: doscc lib cache {sub} <file.tar.gz|dir>",
+                  file=sys.stderr)
+            return 1
+        path = Path(args[1]).expanduser()
+        if sub == "export":
+            n = libcache.export_cache(path)
+            print(f"exported {n} cache entr{'y' if n == 1 else 'ies'} to {path}")
+        else:
+            if not path.exists():
+                print(f"error: {path} not found", file=sys.stderr)
+                return 1
+            n = libcache.import_cache(path)
+            print(f"imported {n} new cache entr{'y' if n == 1 else 'ies'} from {path}")
+        return 0
+
+    elif sub == "clear":
+        n = libcache.clear()
+        print(f"removed {n} cache entr{'y' if n == 1 else 'ies'}")
+        return 0
+
+    else:
+        print(f"error: unknown cache subcommand '{sub}'", file=sys.stderr)
+        return 1
+
+
+# ======================================================================
+# Dependency graph
+# ======================================================================
+
+def _graph_cmd(dot: bool) -> int:
+    """Print the DEPS graph, its build order and critical path."""
+    graph = libgraph.load_graph()
+    if not graph.deps:
+        print("no libraries installed")
+        return 0
+
+    for name, deps in sorted(graph.missing.items()):
+        for dep in deps:
+            print(f"warning: {name.upper()} depends on {dep.upper()} "
+                  f"which is not installed", file=sys.stderr)
+
+    try:
+        order = libgraph.topo_order(graph)
+    except libgraph.CycleError as e:
+        print(f"error: {e}", file=sys.stderr)
+        return 1
+
+    if dot:
+        print(libgraph.to_dot(graph))
+        return 0
+
+    print(f"{len(graph.deps)} libraries, {graph.edges} dependencies")
+    for name in order:
+        deps = ", ".join(d.upper() for d in graph.deps[name]) or "-"
+        print(f"  {name.upper():10} {graph.cost[name]:3} modules  deps: {deps}")
+    print("build order: " + " ".join(n.upper() for n in order))
+
+    path, cost = libgraph.critical_path(graph)
+    chain = " -> ".join(n.upper() for n in reversed(path))
+    print(f"critical path: {chain} ({cost} modules)")
+    return 0
+
+
 # ======================================================================
 # Entry point
 # ======================================================================
@@ -402,7 +332,9 @@ def run(args: list[str]) -> int:
         return 0
 
     verbose = "-v" in args or "--verbose" in args
-    cmd_args = [a for a in args if not a.startswith("-")]
+    # The count after a bare -j is an option value, not a name
+    cmd_args = [a for i, a in enumerate(args) if not a.startswith("-")
+                and (i == 0 or args[i - 1] != "-j")]
 
     subcmd = cmd_args[0]
 
@@ -410,10 +342,26 @@ def run(args: list[str]) -> int:
         return _list_libs()
 
     elif subcmd == "build":
+        variants = _parse_variants(args)
+        if variants is None:
+            return 1
+        jobs = _parse_jobs(args)
+        if jobs is None:
+            return 1
+        opts = LibBuildOptions(verbose=verbose, jobs=jobs,
+                               rebuild="--rebuild" in args,
+                               use_cache="--no-cache" not in args,
+                               variants=variants)
         if len(cmd_args) > 1:
-            return _build_lib(cmd_args[1], verbose)
+            return build_lib(cmd_args[1], opts)
         else:
-            return _build_all(verbose)
+            return build_all(opts)
+
+    elif subcmd == "graph":
+        return _graph_cmd("--dot" in args)
+
+    elif subcmd == "cache":
+        return _cache_cmd(cmd_args[1:])
 
     elif subcmd == "new":
         if len(cmd_args) < 2:
@@ -251,10 +251,20 @@ def _install_libs() -> None:
         dest.mkdir(parents=True, exist_ok=True)
 
         # Copy .H and .C source files (don't overwrite .LIB if already built)
+        sources = {item.name.upper() for item in lib_src.iterdir()
+                   if item.suffix.upper() in (".H", ".C", ".ASM")}
         for item in lib_src.iterdir():
-            if item.suffix.upper() in (".H", ".C", ".ASM"):
+            if item.name.upper() in sources:
                 shutil.copy2(item, dest / item.name)
 
+        # Drop sources the bundle no longer has (e.g. VIDEO.C after the
+        # library was split into per-function modules); the next build
+        # removes their modules from the archive
+        for item in dest.iterdir():
+            if (item.suffix.upper() in (".H", ".C", ".ASM")
+                    and item.name.upper() not in sources):
+                item.unlink()
+
         installed += 1
         has_lib = any(dest.glob("*.LIB")) or any(dest.glob("*.lib"))
         status = "installed (built)" if has_lib else "installed (run 'doscc lib build' to compile)"
@@ -0,0 +1,141 @@
+"""ABI manifests for built library variants.
+
+Every built variant gets a manifest next to it (SVIDEO.LIB -> SVIDEO.ABI)
+recording the memory model, FP mode, tool flags and toolchain it was
+built with, plus each module's size and public symbols as reported by
+the LIB.EXE listing. Targets check it before running LINK, so a model
+mismatch is refused up front instead of crashing at runtime.
+"""
+
+import json
+import re
+from pathlib import Path
+
+from xt import BuildError
+
+
+ABI_SUFFIX = ".ABI"
+
+# Bump when the manifest layout changes
+ABI_VERSION = 1
+
+# CL.EXE floating-point options; no option means the emulator (/FPi)
+FP_MODES = {
+    "/FPI": "emulator",
+    "/FPC": "emulator-calls",
+    "/FPI87": "8087",
+    "/FPC87": "8087-calls",
+    "/FPA": "alternate",
+}
+
+# (library FP mode, project FP mode) pairs that link correctly: in-line
+# emulator code runs unchanged against the 8087 runtime
+FP_COMPATIBLE = {("emulator", "8087"), ("emulator-calls", "8087-calls")}
+
+
+class AbiError(BuildError):
+    """Raised before LINK when a library doesn't match the project."""
+    def __init__(self, message: str):
+        super().__init__("LINK.EXE", 1)
+        Exception.__init__(self, message)
+
+
+def fp_mode(flags: str) -> str:
+    """Return the FP mode selected by a CL.EXE command line."""
+    mode = "emulator"
+    for flag in flags.split():
+        mode = FP_MODES.get(flag.upper(), mode)
+    return mode
+
+
+def manifest_path(lib_path: Path) -> Path:
+    return lib_path.with_suffix(ABI_SUFFIX)
+
+
+# ======================================================================
+# LIB.EXE listing
+# ======================================================================
+
+_MODULE_RE = re.compile(
+    r"^(\S+)\s+Offset:\s*([0-9A-F]+)H\s+Code and data size:\s*([0-9A-F]+)H",
+    re.IGNORECASE)
+
+
+def parse_listing(text: str) -> dict[str, dict]:
+    """Parse the per-module section of a LIB.EXE listing file.
+
+    Each module appears as a header line followed by its publics:
+
+        vidputs         Offset: 00000410H  Code and data size: 3aH
+          _vid_puts
+    """
+    modules: dict[str, dict] = {}
+    current = None
+    for line in text.splitlines():
+        m = _MODULE_RE.match(line)
+        if m:
+            current = {"size": int(m.group(3), 16), "publics": []}
+            modules[m.group(1).upper()] = current
+        elif current is not None and line.startswith((" ", "\t")):
+            current["publics"].extend(line.split())
+        elif not line.strip():
+            continue
+        else:
+            current = None
+    return modules
+
+
+# ======================================================================
+# Manifest
+# ======================================================================
+
+def write_manifest(lib_path: Path, library: str, model: str, flags: str,
+                   toolchain: str, modules: dict[str, dict]) -> None:
+    manifest_path(lib_path).write_text(json.dumps({
+        "version": ABI_VERSION,
+        "library": library.lower(),
+        "lib": lib_path.name.upper(),
+        "model": model,
+        "fp": fp_mode(flags.split("|")[0]),
+        "flags": flags,
+        "toolchain": toolchain,
+        "modules": modules,
+    }, indent=2, sort_keys=True))
+
+
+def read_manifest(lib_path: Path) -> dict | None:
+    """Return the manifest for a built .LIB, or None if missing/corrupt."""
+    try:
+        manifest = json.loads(manifest_path(lib_path).read_text())
+    except (OSError, ValueError):
+        return None
+    if manifest.get("version") != ABI_VERSION:
+        return None
+    return manifest
+
+
+def check(lib_path: Path, library: str, model: str, fp: str,
+          toolchain: str | None) -> list[str]:
+    """Check a library variant against what the project compiles.
+
+    Returns warnings; raises AbiError for a memory model mismatch, which
+    would mix near and far calls and pointers.
+    """
+    manifest = read_manifest(lib_path)
+    name = lib_path.name.upper()
+    if manifest is None:
+        return [f"{name} has no ABI manifest; rebuild it with "
+                f"'doscc lib build {library.lower()}'"]
+
+    if manifest["model"] != model:
+        raise AbiError(f"{name} was built for the {manifest['model']} model "
+                       f"but the project is {model} model")
+
+    warnings = []
+    lib_fp = manifest["fp"]
+    if lib_fp != fp and (lib_fp, fp) not in FP_COMPATIBLE:
+        warnings.append(f"{name} was built with {lib_fp} floating point, "
+                        f"the project uses {fp}")
+    if toolchain and manifest["toolchain"] != toolchain:
+        warnings.append(f"{name} was built with a different toolchain")
+    return warnings
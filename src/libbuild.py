@@ -0,0 +1,616 @@
+"""Library build machinery shared by 'doscc lib' and 'doscc build'.
+
+Builds the libraries installed in ~/.doscc/libs/ once per memory model,
+incrementally (only changed modules are recompiled and replaced in the
+archive), through the content-addressed build cache, and tracks enough
+state to tell when a built variant has gone stale.
+"""
+
+import hashlib
+import json
+import os
+import queue
+import shutil
+import sys
+import tempfile
+import time
+from concurrent.futures import ThreadPoolExecutor
+from dataclasses import dataclass, field, replace
+from pathlib import Path
+
+import libabi
+import libcache
+from config import LIBS_DIR, load_global_config
+from libgraph import CycleError, lib_deps, load_graph, topo_order
+from xt import XTRunner, BuildError
+
+
+# Memory models every library is built for, and the CL.EXE /A letter that
+# doubles as the variant's library name prefix (SVIDEO.LIB, LVIDEO.LIB, ...)
+# the same way MS C names its own xLIBCE.LIB.
+LIB_MODELS = {
+    "small": "S",
+    "medium": "M",
+    "compact": "C",
+    "large": "L",
+}
+
+# Suffix and extra CL.EXE flag for the optional speed-optimized variants
+SPEED_SUFFIX = "X"
+SPEED_FLAGS = "/Ox"
+
+# Per-library build state (module objects + content hashes) lives here,
+# next to the .LIB, so rebuilds only recompile what changed.
+STATE_DIR = ".build"
+
+@dataclass
+class LibVariant:
+    """One memory-model/optimization build of a library."""
+    model: str              # small | medium | compact | large
+    speed: bool = False     # /Ox build, named with SPEED_SUFFIX
+    defines: tuple[str, ...] = ()   # extra /D for CL.EXE and MASM.EXE
+
+    @property
+    def tag(self) -> str:
+        """Short variant tag, e.g. 'S' or 'SX'."""
+        return LIB_MODELS[self.model] + (SPEED_SUFFIX if self.speed else "")
+
+    def lib_name(self, name: str) -> str:
+        """Return the variant's .LIB filename for library 'name'."""
+        suffix = SPEED_SUFFIX if self.speed else ""
+        return f"{LIB_MODELS[self.model]}{name.upper()}{suffix}.LIB"
+
+    def cl_flags(self) -> str:
+        flags = f"/c /A{LIB_MODELS[self.model]} /Zl /Gs"
+        if self.speed:
+            flags += f" {SPEED_FLAGS}"
+        return flags + self._define_flags()
+
+    def masm_flags(self) -> str:
+        # /ML = case-sensitive names (required for C linkage);
+        # /Dmem? selects the model the way CMACROS.INC expects
+        return f"/ML /Dmem{LIB_MODELS[self.model]}" + self._define_flags()
+
+    def _define_flags(self) -> str:
+        return "".join(f" /D{d}" for d in self.defines)
+
+    def flags(self) -> str:
+        """All tool flags, as recorded in the build state."""
+        return f"{self.cl_flags()} | {self.masm_flags()}"
+
+
+@dataclass
+class LibBuildOptions:
+    verbose: bool = False
+    jobs: int = 1
+    rebuild: bool = False
+    use_cache: bool = True
+    variants: list[LibVariant] = field(
+        default_factory=lambda: [LibVariant(m) for m in LIB_MODELS])
+
+# ======================================================================
+# Build
+# ======================================================================
+
+def _compile_module(runner: XTRunner, variant: LibVariant, dos_name: str,
+                    slot: int) -> str:
+    """Compile or assemble SRC\\dos_name for one variant into OBJ\\<tag>\\.
+
+    Returns the DOS .OBJ path. Each concurrent job runs with its own TMP
+    directory so the compiler pass files of parallel CL.EXE instances don't
+    collide.
+    """
+    out_dir = f"OBJ\\{variant.tag}"
+    obj_path = f"{out_dir}\\{_obj_name(dos_name)}"
+    env = {"TMP": f"C:\\TMP\\{slot}"}
+
+    if dos_name.endswith(".ASM"):
+        args = (f"{variant.masm_flags()} /IINCLUDE "
+                f"SRC\\{dos_name},{obj_path},NUL,NUL;")
+        runner.run_checked("BIN\\MASM.EXE", args, env_vars=env,
+                           tool_name="MASM.EXE")
+    else:
+        args = f"{variant.cl_flags()} /IINCLUDE /Fo{out_dir}\\ SRC\\{dos_name}"
+        runner.run_checked("BIN\\CL.EXE", args, env_vars=env,
+                           tool_name="CL.EXE")
+    return obj_path
+
+
+def _compile_modules(runner: XTRunner, build_dir: Path,
+                     jobs_list: list[tuple[LibVariant, str]],
+                     jobs: int) -> list[str] | None:
+    """Compile (variant, module) pairs concurrently.
+
+    Returns DOS .OBJ paths in input order. On failure, reports the first
+    failing module (in input order), cancels modules that have not started
+    yet, and returns None.
+    """
+    jobs = max(1, min(jobs, len(jobs_list)))
+    slots: queue.Queue[int] = queue.Queue()
+    for i in range(jobs):
+        (build_dir / "TMP" / str(i)).mkdir(parents=True)
+        slots.put(i)
+
+    def work(variant: LibVariant, dos_name: str) -> str:
+        slot = slots.get()
+        try:
+            return _compile_module(runner, variant, dos_name, slot)
+        finally:
+            slots.put(slot)
+
+    with ThreadPoolExecutor(max_workers=jobs) as pool:
+        futures = [pool.submit(work, v, n) for v, n in jobs_list]
+        obj_files = []
+        for (variant, dos_name), future in zip(jobs_list, futures):
+            try:
+                obj_files.append(future.result())
+            except BuildError as e:
+                for f in futures:
+                    f.cancel()
+                print(f"\nerror: compiling {dos_name} ({variant.model}"
+                      f"{', speed' if variant.speed else ''}): {e}",
+                      file=sys.stderr)
+                if e.output:
+                    print(e.output, file=sys.stderr)
+                return None
+        return obj_files
+
+
+def _obj_name(source_name: str) -> str:
+    """Return the uppercase .OBJ name a source file compiles to."""
+    return source_name.upper().rsplit(".", 1)[0] + ".OBJ"
+
+
+def _lib_sources(lib_dir: Path) -> list[Path]:
+    """Return a library's compilable sources (.C then .ASM)."""
+    c_sources = sorted(lib_dir.glob("*.C"))
+    if not c_sources:
+        c_sources = sorted(lib_dir.glob("*.c"))
+    asm_sources = sorted(lib_dir.glob("*.ASM"))
+    if not asm_sources:
+        asm_sources = sorted(lib_dir.glob("*.asm"))
+    return c_sources + asm_sources
+
+
+def _file_hash(path: Path) -> str:
+    """Return the SHA-256 hex digest of a file's contents."""
+    return hashlib.sha256(path.read_bytes()).hexdigest()
+
+
+def _load_state(path: Path) -> dict:
+    """Load saved module state, or an empty dict if missing/corrupt."""
+    try:
+        return json.loads(path.read_text())
+    except (OSError, ValueError):
+        return {}
+
+
+@dataclass
+class _VariantPlan:
+    """What an incremental build has to do for one variant."""
+    variant: LibVariant
+    lib_name: str
+    obj_dir: Path                   # kept module objects
+    state_path: Path                # module hashes + flags
+    full: bool                      # recreate the archive from scratch
+    changed: list[Path]             # sources to (re)compile
+    removed: list[str]              # modules to drop from the archive
+    old_hashes: dict[str, str]      # module hashes the archive was built from
+    digest: str                     # libcache.lib_digest, for staleness
+    obj_files: list[str] = field(default_factory=list)
+    cache_key: str = ""
+
+
+def _plan_variant(lib_dir: Path, name: str, variant: LibVariant,
+                  sources: list[Path], hashes: dict[str, str],
+                  headers: str, digest: str, rebuild: bool) -> _VariantPlan:
+    """Work out which modules of one variant need compiling.
+
+    Any change to flags or headers, or a missing .LIB, forces a full
+    rebuild of the archive.
+    """
+    lib_name = variant.lib_name(name)
+    stem = lib_name.rsplit(".", 1)[0]
+    obj_dir = lib_dir / STATE_DIR / stem
+    state_path = lib_dir / STATE_DIR / f"{stem}.json"
+    state = {} if rebuild else _load_state(state_path)
+    old_hashes = state.get("modules", {})
+
+    full = (not (lib_dir / lib_name).exists()
+            or state.get("flags") != variant.flags()
+            or state.get("headers") != headers)
+    if full:
+        changed = list(sources)
+        removed = []
+        old_hashes = {}
+    else:
+        changed = [src for src in sources
+                   if old_hashes.get(src.name.upper()) != hashes[src.name.upper()]
+                   or not (obj_dir / _obj_name(src.name)).exists()]
+        removed = [m for m in old_hashes if m not in hashes]
+
+    return _VariantPlan(variant, lib_name, obj_dir, state_path,
+                        full, changed, removed, old_hashes, digest)
+
+
+def _save_state(plan: _VariantPlan, hashes: dict[str, str],
+                headers: str) -> None:
+    """Record what the variant's archive and kept objects were built from."""
+    plan.state_path.parent.mkdir(parents=True, exist_ok=True)
+    plan.state_path.write_text(json.dumps({
+        "flags": plan.variant.flags(),
+        "defines": list(plan.variant.defines),
+        "headers": headers,
+        "digest": plan.digest,
+        "modules": hashes,
+    }, indent=2))
+
+
+def _archive_variant(runner: XTRunner, build_dir: Path, lib_dir: Path,
+                     name: str, plan: _VariantPlan, hashes: dict[str, str],
+                     headers: str, tc_path: Path) -> bool:
+    """Create or update one variant's .LIB with a single LIB.EXE call.
+
+    The same call writes a listing of the finished archive, from which
+    the variant's ABI manifest is made. On success, copies the archive
+    back and saves module objects and hashes for the next incremental
+    build.
+    """
+    lib_name = plan.lib_name
+    lib_path = lib_dir / lib_name
+
+    # An incremental update edits a copy of the existing archive in place
+    if not plan.full:
+        shutil.copy2(lib_path, build_dir / "LIB" / lib_name)
+
+    # LIB libname +new -+replaced -removed, listing ;
+    ops = []
+    for src, obj in zip(plan.changed, plan.obj_files):
+        ops.append(f"+{obj}" if src.name.upper() not in plan.old_hashes
+                   else f"-+{obj}")
+    for module in plan.removed:
+        ops.append(f"-{module.rsplit('.', 1)[0]}")
+    # Variants are archived concurrently; keep LIB.EXE temp files apart
+    tmp = build_dir / "TMP" / plan.variant.tag
+    tmp.mkdir(parents=True, exist_ok=True)
+    env = {"TMP": f"C:\\TMP\\{plan.variant.tag}"}
+    listing = tmp / "LIB.LST"
+    # A library's operations run far past the 127-byte DOS command tail,
+    # so they go to LIB.EXE in a response file, one per line joined with
+    # '&'. A new library is confirmed with Y, as at the Create? prompt.
+    lines = [f"LIB\\{lib_name}"]
+    if plan.full:
+        lines.append("Y")
+    lines += ([f"{op} &" for op in ops[:-1]] + ops[-1:]) or [""]
+    lines.append(f"TMP\\{plan.variant.tag}\\LIB.LST;")
+    (tmp / "LIB.RSP").write_text("\r\n".join(lines) + "\r\n")
+    args = f"@TMP\\{plan.variant.tag}\\LIB.RSP"
+
+    try:
+        runner.run_checked("BIN\\LIB.EXE", args, env_vars=env,
+                           tool_name="LIB.EXE")
+    except BuildError as e:
+        print(f"\nerror: creating {lib_name}: {e}", file=sys.stderr)
+        if e.output:
+            print(e.output, file=sys.stderr)
+        return False
+
+    # Copy built .LIB back to library directory
+    built_lib = build_dir / "LIB" / lib_name
+    if not built_lib.exists():
+        print(f"error: {lib_name} was not created", file=sys.stderr)
+        return False
+
+    shutil.copy2(built_lib, lib_path)
+    if not listing.exists():
+        print(f"error: LIB.EXE wrote no listing for {lib_name}", file=sys.stderr)
+        return False
+    libabi.write_manifest(lib_path, name, plan.variant.model,
+                          plan.variant.flags(),
+                          libcache.toolchain_fingerprint(tc_path),
+                          libabi.parse_listing(listing.read_text(errors="replace")))
+
+    # Keep module objects and hashes for the next incremental build
+    if plan.full and plan.obj_dir.exists():
+        shutil.rmtree(plan.obj_dir)
+    plan.obj_dir.mkdir(parents=True, exist_ok=True)
+    for obj in plan.obj_files:
+        host_obj = build_dir / obj.replace("\\", "/")
+        shutil.copy2(host_obj, plan.obj_dir / host_obj.name)
+    for module in plan.removed:
+        (plan.obj_dir / _obj_name(module)).unlink(missing_ok=True)
+    _save_state(plan, hashes, headers)
+    return True
+
+
+def build_lib(name: str, opts: LibBuildOptions) -> int:
+    """Build every model variant of a library, recompiling only modules that
+    changed."""
+    lib_dir = LIBS_DIR / name.lower()
+    if not lib_dir.exists():
+        print(f"error: library '{name}' not found in {LIBS_DIR}", file=sys.stderr)
+        return 1
+
+    sources = _lib_sources(lib_dir)
+
+    # Header-only libraries: have .H files but no compilable sources
+    if not sources:
+        has_headers = any(lib_dir.glob("*.H")) or any(lib_dir.glob("*.h"))
+        if has_headers:
+            print(f"{name.upper()}: header-only, nothing to build")
+            return 0
+        print(f"error: no .C or .ASM source files in {lib_dir}", file=sys.stderr)
+        return 1
+
+    # Variant names must still fit DOS 8.3 (prefix + name + suffix)
+    for variant in opts.variants:
+        if len(variant.lib_name(name)) > len("XXXXXXXX.LIB"):
+            print(f"error: library name '{name.upper()}' is too long for "
+                  f"model variant {variant.lib_name(name)}", file=sys.stderr)
+            return 1
+
+    # Check DEPS file — all dependencies must be built first, per variant
+    for dep in lib_deps(lib_dir):
+        dep_dir = LIBS_DIR / dep
+        for variant in opts.variants:
+            dep_lib = variant.lib_name(dep)
+            if not dep_dir.exists() or not (dep_dir / dep_lib).exists():
+                print(f"error: {name.upper()} depends on {dep_lib} "
+                      f"which is not built yet", file=sys.stderr)
+                print(f"build it first: doscc lib build {dep}", file=sys.stderr)
+                return 1
+
+    # Load global config for toolchain
+    global_cfg = load_global_config()
+    if "msc50" not in global_cfg.toolchains:
+        print("error: toolchain 'msc50' not configured", file=sys.stderr)
+        print("run 'doscc setup' first", file=sys.stderr)
+        return 1
+
+    tc = global_cfg.toolchains["msc50"]
+
+    hashes = {src.name.upper(): _file_hash(src) for src in sources}
+    headers = libcache.headers_digest()
+    digest = libcache.lib_digest(name)
+    plans = [_plan_variant(lib_dir, name, v, sources, hashes, headers,
+                           digest, opts.rebuild)
+             for v in opts.variants]
+    # Variants built before manifests existed just need a LIB listing
+    todo = [p for p in plans if p.changed or p.removed
+            or libabi.read_manifest(lib_dir / p.lib_name) is None]
+    for plan in plans:
+        if plan not in todo:
+            # A dependency may have changed without affecting any of our
+            # objects; record that this variant is current again
+            if _load_state(plan.state_path).get("digest") != digest:
+                _save_state(plan, hashes, headers)
+                print(f"{plan.lib_name} is up to date "
+                      f"(no module affected by the change)")
+            else:
+                print(f"{plan.lib_name} is up to date")
+
+    # Anything still to build may already exist in the cache
+    if opts.use_cache:
+        for plan in list(todo):
+            plan.cache_key = libcache.cache_key(name, plan.lib_name,
+                                                plan.variant.flags(), tc.path)
+            if libcache.restore(plan.cache_key, plan.lib_name,
+                                lib_dir / plan.lib_name, plan.obj_dir):
+                _save_state(plan, hashes, headers)
+                todo.remove(plan)
+                print(f"{plan.lib_name} restored from cache")
+    if not todo:
+        return 0
+
+    start = time.time()
+
+    # Create temp workspace
+    with tempfile.TemporaryDirectory() as tmpdir:
+        build_dir = Path(tmpdir)
+
+        # Symlink toolchain BIN/
+        os.symlink(tc.path / "BIN", build_dir / "BIN")
+
+        # Merge includes: toolchain headers + library's own headers
+        inc_dir = build_dir / "INCLUDE"
+        inc_dir.mkdir()
+        tc_inc = tc.path / "INCLUDE"
+        if tc_inc.exists():
+            for item in tc_inc.iterdir():
+                os.symlink(item, inc_dir / item.name)
+        for h in lib_dir.iterdir():
+            if h.suffix.upper() == ".H":
+                dest = inc_dir / h.name.upper()
+                if not dest.exists():
+                    os.symlink(h, dest)
+
+        # Cross-library headers: symlink .H from all other installed libs
+        if LIBS_DIR.exists():
+            for other_lib in LIBS_DIR.iterdir():
+                if other_lib.is_dir() and other_lib != lib_dir:
+                    for h in other_lib.iterdir():
+                        if h.suffix.upper() == ".H":
+                            dest = inc_dir / h.name.upper()
+                            if not dest.exists():
+                                os.symlink(h, dest)
+
+        # Copy the sources that need compiling into SRC/; each variant
+        # compiles into its own OBJ/<tag>/
+        src_dir = build_dir / "SRC"
+        src_dir.mkdir()
+        for plan in todo:
+            (build_dir / "OBJ" / plan.variant.tag).mkdir(parents=True)
+            for src in plan.changed:
+                dest = src_dir / src.name.upper()
+                if not dest.exists():
+                    shutil.copy2(src, dest)
+
+        # LIB/ for output
+        lib_out_dir = build_dir / "LIB"
+        lib_out_dir.mkdir()
+
+        runner = XTRunner(global_cfg.xt_path, build_dir, verbose=opts.verbose)
+
+        # Compile the modules of all variants concurrently, then archive
+        # each variant in one LIB.EXE step
+        jobs_list = [(plan.variant, src.name.upper())
+                     for plan in todo for src in plan.changed]
+        if jobs_list:
+            obj_files = _compile_modules(runner, build_dir, jobs_list, opts.jobs)
+            if obj_files is None:
+                return 1
+            for plan in todo:
+                plan.obj_files = obj_files[:len(plan.changed)]
+                obj_files = obj_files[len(plan.changed):]
+
+        with ThreadPoolExecutor(max_workers=max(1, min(opts.jobs, len(todo)))) as pool:
+            results = list(pool.map(
+                lambda p: _archive_variant(runner, build_dir, lib_dir, name,
+                                           p, hashes, headers, tc.path),
+                todo))
+        if not all(results):
+            return 1
+
+    if opts.use_cache:
+        for plan in todo:
+            libcache.store(plan.cache_key, plan.lib_name,
+                           lib_dir / plan.lib_name, plan.obj_dir)
+
+    elapsed = time.time() - start
+    for plan in todo:
+        if plan.full:
+            print(f"built {plan.lib_name} ({elapsed:.1f}s)")
+        elif not plan.changed and not plan.removed:
+            print(f"wrote ABI manifest for {plan.lib_name}")
+        else:
+            print(f"updated {plan.lib_name}: {len(plan.changed)} recompiled, "
+                  f"{len(plan.removed)} removed ({elapsed:.1f}s)")
+    return 0
+
+
+def build_all(opts: LibBuildOptions) -> int:
+    """Build all libraries in dependency order."""
+    if not LIBS_DIR.exists():
+        print("no libraries installed")
+        print("run 'doscc setup' to install library sources")
+        return 0
+
+    try:
+        order = topo_order(load_graph())
+    except CycleError as e:
+        print(f"error: {e}", file=sys.stderr)
+        return 1
+    if not order:
+        print("no libraries found")
+        return 0
+
+    built = 0
+    rc = 0
+    for name in order:
+        lib_dir = LIBS_DIR / name
+        has_source = (any(lib_dir.glob("*.C")) or any(lib_dir.glob("*.c"))
+                      or any(lib_dir.glob("*.ASM")) or any(lib_dir.glob("*.asm")))
+        has_headers = any(lib_dir.glob("*.H")) or any(lib_dir.glob("*.h"))
+        if has_source or has_headers:
+            result = build_lib(name, opts)
+            if result != 0:
+                rc = result
+            else:
+                built += 1
+
+    if built == 0 and rc == 0:
+        print("no libraries with source files found")
+
+    return rc
+
+
+# ======================================================================
+# Staleness
+# ======================================================================
+
+def variant_for(model: str, speed: bool = False) -> LibVariant:
+    """Return the library variant a project of this model links against
+    (tiny-model programs, or an unknown model, use the small-model
+    libraries)."""
+    return LibVariant(model if model in LIB_MODELS else "small", speed)
+
+
+def built_variant(name: str, variant: LibVariant) -> LibVariant:
+    """Return variant with the -D defines it was last built with.
+
+    A library deliberately built with 'doscc lib build -DNAME' keeps its
+    defines when a project build checks or rebuilds it.
+    """
+    lib_name = variant.lib_name(name)
+    stem = lib_name.rsplit(".", 1)[0]
+    state = _load_state(LIBS_DIR / name.lower() / STATE_DIR / f"{stem}.json")
+    return replace(variant, defines=tuple(state.get("defines", ())))
+
+
+def stale_reason(name: str, variant: LibVariant) -> str | None:
+    """Return why a built variant is out of date, or None if it's current.
+
+    A variant is stale when its sources, headers or anything in its DEPS
+    closure changed since it was built, so a change to a dependency makes
+    every library that depends on it stale as well.
+    """
+    lib_dir = LIBS_DIR / name.lower()
+    if not _lib_sources(lib_dir):
+        return None         # header-only: nothing to go stale
+    lib_name = variant.lib_name(name)
+    if not (lib_dir / lib_name).exists():
+        return "not built"
+    stem = lib_name.rsplit(".", 1)[0]
+    state = _load_state(lib_dir / STATE_DIR / f"{stem}.json")
+    if not state:
+        return "no build state"
+    if state.get("flags") != built_variant(name, variant).flags():
+        return "built with different flags"
+    if state.get("digest") != libcache.lib_digest(name):
+        return "sources or dependencies changed"
+    if libabi.read_manifest(lib_dir / lib_name) is None:
+        return "no ABI manifest"
+    return None
+
+
+def dep_closure(names: list[str]) -> list[str]:
+    """Return names plus everything they depend on, in build order.
+
+    Raises CycleError if the DEPS files form a cycle.
+    """
+    graph = load_graph()
+    wanted = set()
+    pending = [n.lower() for n in names]
+    while pending:
+        name = pending.pop()
+        if name in wanted or name not in graph.deps:
+            continue
+        wanted.add(name)
+        pending.extend(graph.deps[name])
+    return [n for n in topo_order(graph) if n in wanted]
+
+
+def ensure_current(names: list[str], variants: list[LibVariant],
+                   opts: LibBuildOptions) -> int:
+    """Rebuild any stale variant of the named libraries and their DEPS.
+
+    Libraries are visited in dependency order, so a rebuilt dependency is
+    in place before the libraries that depend on it.
+    """
+    try:
+        order = dep_closure(names)
+    except CycleError as e:
+        print(f"error: {e}", file=sys.stderr)
+        return 1
+    for name in order:
+        stale = []
+        for variant in variants:
+            reason = stale_reason(name, variant)
+            if reason:
+                print(f"{variant.lib_name(name)} is stale ({reason}), rebuilding")
+                stale.append(built_variant(name, variant))
+        if stale:
+            rc = build_lib(name, replace(opts, variants=stale))
+            if rc != 0:
+                return rc
+    return 0
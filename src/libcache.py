@@ -0,0 +1,235 @@
+"""Content-addressed cache of built library variants.
+
+A cache entry holds one finished .LIB plus its module objects, keyed by
+everything that determines its contents: the library's sources, the same
+for every library in its DEPS closure, every installed header, the tool
+flags, and a fingerprint of the toolchain. Entries can be exported to and
+imported from a tarball or a plain directory (e.g. on a shared mount), so
+a fresh machine can skip library builds entirely.
+"""
+
+import hashlib
+import shutil
+import tarfile
+import tempfile
+from functools import lru_cache
+from pathlib import Path
+
+from config import GLOBAL_CONFIG_DIR, LIBS_DIR
+from libabi import manifest_path
+from libgraph import lib_deps
+
+
+CACHE_DIR = GLOBAL_CONFIG_DIR / "cache" / "libs"
+
+# Bump when the key recipe or entry layout changes
+CACHE_VERSION = "3"
+
+# Layout of one entry: CACHE_DIR/<key[:2]>/<key>/{NAME.LIB, NAME.ABI, OBJ/*.OBJ}
+ENTRY_OBJ_DIR = "OBJ"
+
+_TARBALL_SUFFIXES = (".tar", ".tar.gz", ".tgz")
+
+
+# ======================================================================
+# Keys
+# ======================================================================
+
+@lru_cache(maxsize=None)
+def toolchain_fingerprint(tc_path: Path) -> str:
+    """Hash the toolchain's BIN/ and INCLUDE/ contents.
+
+    Any compiler, assembler, librarian or system header change yields a
+    different fingerprint, and therefore different cache keys.
+    """
+    h = hashlib.sha256()
+    for sub in ("BIN", "INCLUDE"):
+        root = tc_path / sub
+        if not root.exists():
+            continue
+        for f in sorted(root.rglob("*")):
+            if f.is_file():
+                h.update(f.relative_to(tc_path).as_posix().upper().encode())
+                h.update(f.read_bytes())
+    return h.hexdigest()
+
+
+def headers_digest() -> str:
+    """Hash every installed library's .H files.
+
+    Each library compiles with all installed headers on its include path
+    and we don't track which module includes what, so any header change
+    counts against every library.
+    """
+    h = hashlib.sha256()
+    if LIBS_DIR.exists():
+        for lib_dir in sorted(LIBS_DIR.iterdir()):
+            if not lib_dir.is_dir():
+                continue
+            for hdr in sorted(lib_dir.iterdir()):
+                if hdr.suffix.upper() == ".H":
+                    h.update(hdr.name.upper().encode())
+                    h.update(hdr.read_bytes())
+    return h.hexdigest()
+
+
+def _closure_digest(name: str, _seen: tuple[str, ...] = ()) -> str:
+    """Hash a library's sources and headers plus its whole DEPS closure."""
+    name = name.lower()
+    lib_dir = LIBS_DIR / name
+    h = hashlib.sha256()
+    h.update(name.encode())
+    if lib_dir.exists():
+        for f in sorted(lib_dir.iterdir()):
+            if f.is_file() and f.suffix.upper() in (".C", ".ASM", ".H"):
+                h.update(f.name.upper().encode())
+                h.update(hashlib.sha256(f.read_bytes()).digest())
+    for dep in sorted(lib_deps(lib_dir)):
+        # A cycle is reported by the build; don't recurse forever here
+        if dep in _seen or dep == name:
+            continue
+        h.update(f"dep {dep} {_closure_digest(dep, _seen + (name,))}".encode())
+    return h.hexdigest()
+
+
+def lib_digest(name: str) -> str:
+    """Hash everything a library's objects are built from: its sources and
+    DEPS closure, and every header visible to its build."""
+    return hashlib.sha256(f"{_closure_digest(name)} "
+                          f"{headers_digest()}".encode()).hexdigest()
+
+
+def cache_key(name: str, lib_name: str, flags: str, tc_path: Path) -> str:
+    """Return the cache key for one variant (lib_name) of a library."""
+    text = "\n".join([
+        f"doscc-lib-cache {CACHE_VERSION}",
+        f"lib {lib_name.upper()}",
+        f"flags {flags}",
+        f"toolchain {toolchain_fingerprint(tc_path)}",
+        f"sources {lib_digest(name)}",
+    ])
+    return hashlib.sha256(text.encode()).hexdigest()
+
+
+# ======================================================================
+# Lookup / store
+# ======================================================================
+
+def _entry_dir(key: str) -> Path:
+    return CACHE_DIR / key[:2] / key
+
+
+def restore(key: str, lib_name: str, lib_path: Path, obj_dir: Path) -> bool:
+    """Copy a cached .LIB, its manifest and objects into place. Returns True
+    on a hit."""
+    entry = _entry_dir(key)
+    cached_lib = entry / lib_name
+    if not cached_lib.exists():
+        return False
+
+    shutil.copy2(cached_lib, lib_path)
+    if manifest_path(cached_lib).exists():
+        shutil.copy2(manifest_path(cached_lib), manifest_path(lib_path))
+    if obj_dir.exists():
+        shutil.rmtree(obj_dir)
+    obj_dir.mkdir(parents=True)
+    cached_objs = entry / ENTRY_OBJ_DIR
+    if cached_objs.exists():
+        for obj in cached_objs.iterdir():
+            shutil.copy2(obj, obj_dir / obj.name)
+    return True
+
+
+def store(key: str, lib_name: str, lib_path: Path, obj_dir: Path) -> None:
+    """Add a freshly built .LIB and its objects to the cache.
+
+    The entry is assembled next to its final location and renamed into
+    place, so concurrent builds never see a half-written entry.
+    """
+    entry = _entry_dir(key)
+    if (entry / lib_name).exists():
+        return
+    entry.parent.mkdir(parents=True, exist_ok=True)
+    staging = Path(tempfile.mkdtemp(dir=entry.parent, prefix=".tmp-"))
+    try:
+        shutil.copy2(lib_path, staging / lib_name)
+        if manifest_path(lib_path).exists():
+            shutil.copy2(manifest_path(lib_path),
+                         manifest_path(staging / lib_name))
+        (staging / ENTRY_OBJ_DIR).mkdir()
+        if obj_dir.exists():
+            for obj in obj_dir.iterdir():
+                shutil.copy2(obj, staging / ENTRY_OBJ_DIR / obj.name)
+        staging.rename(entry)
+    except OSError:
+        # Lost a race with another build storing the same entry
+        shutil.rmtree(staging, ignore_errors=True)
+
+
+# ======================================================================
+# Maintenance / export / import
+# ======================================================================
+
+def entries() -> list[Path]:
+    """Return all complete cache entries."""
+    if not CACHE_DIR.exists():
+        return []
+    return sorted(e for shard in CACHE_DIR.iterdir()
+                  if shard.is_dir() and not shard.name.startswith(".")
+                  for e in shard.iterdir()
+                  if e.is_dir() and not e.name.startswith("."))
+
+
+def clear() -> int:
+    """Remove every cache entry. Returns the number removed."""
+    n = len(entries())
+    if CACHE_DIR.exists():
+        shutil.rmtree(CACHE_DIR)
+    return n
+
+
+def _is_tarball(path: Path) -> bool:
+    return path.name.lower().endswith(_TARBALL_SUFFIXES)
+
+
+def export_cache(dest: Path) -> int:
+    """Write all entries to a tarball or a directory. Returns entry count."""
+    found = entries()
+    if _is_tarball(dest):
+        mode = "w" if dest.name.lower().endswith(".tar") else "w:gz"
+        with tarfile.open(dest, mode) as tar:
+            for entry in found:
+                tar.add(entry, arcname=entry.relative_to(CACHE_DIR).as_posix())
+    else:
+        for entry in found:
+            target = dest / entry.relative_to(CACHE_DIR)
+            if not target.exists():
+                target.parent.mkdir(parents=True, exist_ok=True)
+                shutil.copytree(entry, target)
+    return len(found)
+
+
+def import_cache(src: Path) -> int:
+    """Merge entries from a tarball or directory. Returns entries added."""
+    CACHE_DIR.mkdir(parents=True, exist_ok=True)
+    before = len(entries())
+    if _is_tarball(src):
+        with tarfile.open(src) as tar:
+            with tempfile.TemporaryDirectory(dir=CACHE_DIR, prefix=".import-") as tmp:
+                tar.extractall(tmp, filter="data")
+                _merge_tree(Path(tmp))
+    else:
+        _merge_tree(src)
+    return len(entries()) - before
+
+
+def _merge_tree(root: Path) -> None:
+    """Copy <shard>/<key> entries under root that we don't have yet."""
+    for shard in root.iterdir():
+        if not shard.is_dir() or shard.name.startswith("."):
+            continue
+        for entry in shard.iterdir():
+            target = CACHE_DIR / shard.name / entry.name
+            if entry.is_dir() and not target.exists():
+                target.parent.mkdir(parents=True, exist_ok=True)
+                shutil.copytree(entry, target)
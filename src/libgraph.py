@@ -0,0 +1,167 @@
+"""Library dependency graph built from the DEPS files in ~/.doscc/libs/.
+
+Each library directory may hold a DEPS file listing one library name per
+line ('#' starts a comment). The graph keeps adjacency lists in both
+directions, so ordering is O(V+E), and reports a dependency cycle as the
+actual path rather than silently building its members last.
+"""
+
+from collections import deque
+from dataclasses import dataclass, field
+from pathlib import Path
+
+from config import LIBS_DIR
+
+
+class CycleError(Exception):
+    """Raised when DEPS files form a cycle."""
+    def __init__(self, cycle: list[str]):
+        self.cycle = cycle
+        path = " -> ".join(n.upper() for n in cycle)
+        super().__init__(f"library dependency cycle: {path}")
+
+
+def lib_deps(lib_dir: Path) -> list[str]:
+    """Return the lowercase library names listed in a library's DEPS file."""
+    deps_file = lib_dir / "DEPS"
+    if not deps_file.exists():
+        return []
+    deps = []
+    for line in deps_file.read_text().splitlines():
+        dep = line.strip().lower()
+        if dep and not dep.startswith("#") and dep not in deps:
+            deps.append(dep)
+    return deps
+
+
+@dataclass
+class LibGraph:
+    deps: dict[str, list[str]] = field(default_factory=dict)     # lib -> deps
+    users: dict[str, list[str]] = field(default_factory=dict)    # lib -> dependents
+    missing: dict[str, list[str]] = field(default_factory=dict)  # not installed
+    cost: dict[str, int] = field(default_factory=dict)           # modules to compile
+
+    @property
+    def edges(self) -> int:
+        return sum(len(d) for d in self.deps.values())
+
+
+def load_graph(libs_dir: Path = LIBS_DIR) -> LibGraph:
+    """Read every installed library's DEPS into a graph."""
+    graph = LibGraph()
+    if not libs_dir.exists():
+        return graph
+
+    lib_dirs = sorted(d for d in libs_dir.iterdir() if d.is_dir())
+    for lib_dir in lib_dirs:
+        name = lib_dir.name.lower()
+        graph.deps[name] = []
+        graph.users[name] = []
+        # Build cost estimate: one emulator boot per module
+        graph.cost[name] = sum(1 for f in lib_dir.iterdir()
+                               if f.suffix.upper() in (".C", ".ASM"))
+
+    for lib_dir in lib_dirs:
+        name = lib_dir.name.lower()
+        for dep in sorted(lib_deps(lib_dir)):
+            if dep in graph.deps:
+                graph.deps[name].append(dep)
+                graph.users[dep].append(name)
+            else:
+                graph.missing.setdefault(name, []).append(dep)
+
+    for users in graph.users.values():
+        users.sort()
+    return graph
+
+
+def find_cycle(graph: LibGraph) -> list[str] | None:
+    """Return one dependency cycle as a closed path (a, b, ..., a), or None."""
+    WHITE, GREY, BLACK = 0, 1, 2
+    color = {n: WHITE for n in graph.deps}
+
+    for root in sorted(graph.deps):
+        if color[root] != WHITE:
+            continue
+        # Iterative DFS; the stack doubles as the current path
+        stack = [(root, iter(graph.deps[root]))]
+        color[root] = GREY
+        while stack:
+            node, it = stack[-1]
+            for dep in it:
+                if color[dep] == GREY:
+                    path = [n for n, _ in stack]
+                    return path[path.index(dep):] + [dep]
+                if color[dep] == WHITE:
+                    color[dep] = GREY
+                    stack.append((dep, iter(graph.deps[dep])))
+                    break
+            else:
+                color[node] = BLACK
+                stack.pop()
+    return None
+
+
+def topo_order(graph: LibGraph) -> list[str]:
+    """Return libraries dependencies-first (Kahn's algorithm, O(V+E)).
+
+    Raises CycleError with the offending path if the DEPS form a cycle.
+    """
+    pending = {n: len(d) for n, d in graph.deps.items()}
+    queue = deque(sorted(n for n, k in pending.items() if k == 0))
+    order = []
+    while queue:
+        node = queue.popleft()
+        order.append(node)
+        for user in graph.users[node]:
+            pending[user] -= 1
+            if pending[user] == 0:
+                queue.append(user)
+
+    if len(order) != len(graph.deps):
+        raise CycleError(find_cycle(graph) or sorted(set(graph.deps) - set(order)))
+    return order
+
+
+def critical_path(graph: LibGraph) -> tuple[list[str], int]:
+    """Return the dependency chain with the highest total build cost.
+
+    However many libraries build in parallel, a library can't start before
+    its dependencies finish, so this chain bounds a full rebuild.
+    """
+    best: dict[str, int] = {}
+    via: dict[str, str | None] = {}
+    for node in topo_order(graph):
+        prev = max(graph.deps[node], key=lambda d: (best[d], d), default=None)
+        best[node] = graph.cost[node] + (best[prev] if prev else 0)
+        via[node] = prev
+    if not best:
+        return [], 0
+
+    end = max(best, key=lambda n: (best[n], n))
+    path = []
+    node: str | None = end
+    while node:
+        path.append(node)
+        node = via[node]
+    return path, best[end]
+
+
+def to_dot(graph: LibGraph) -> str:
+    """Render the graph in Graphviz DOT, highlighting the critical path."""
+    path, _ = critical_path(graph)
+    on_path = set(zip(path, path[1:]))
+    lines = ["digraph doscc_libs {", "    rankdir=BT;", "    node [shape=box];"]
+    for name in sorted(graph.deps):
+        style = ", style=bold, color=red" if name in path else ""
+        lines.append(f'    "{name.upper()}" [label="{name.upper()}\\n'
+                     f'{graph.cost[name]} modules"{style}];')
+    for name in sorted(graph.deps):
+        for dep in graph.deps[name]:
+            style = " [style=bold, color=red]" if (name, dep) in on_path else ""
+            lines.append(f'    "{name.upper()}" -> "{dep.upper()}"{style};')
+        for dep in graph.missing.get(name, []):
+            lines.append(f'    "{dep.upper()}" [style=dashed];')
+            lines.append(f'    "{name.upper()}" -> "{dep.upper()}" [style=dashed];')
+    lines.append("}")
+    return "\n".join(lines)
@@ -0,0 +1,265 @@
+"""Link size report: which object and library modules end up in a program.
+
+LINK's .MAP file only lists segments (and publics with /M), not which
+library modules were pulled in or what each one costs. We get that from
+the inputs instead: the OMF records of the project objects and of every
+module in the libraries on the link line give each module's publics,
+externals and segment sizes, and replaying LINK's library search over
+them shows which modules were linked and which symbol pulled them in.
+The .MAP segment table supplies the totals the linker actually produced.
+"""
+
+import re
+from dataclasses import dataclass, field
+from pathlib import Path
+
+
+# OMF record types (MS C 5.0 / LINK 5.x subset)
+THEADR = 0x80
+MODEND, MODEND32 = 0x8A, 0x8B
+EXTDEF = 0x8C
+PUBDEF, PUBDEF32 = 0x90, 0x91
+LNAMES = 0x96
+SEGDEF, SEGDEF32 = 0x98, 0x99
+LIBHDR, LIBEND = 0xF0, 0xF1
+
+
+@dataclass
+class OmfModule:
+    name: str                   # THEADR name, e.g. "vidputs.c"
+    origin: str                 # "FOO.OBJ" or "SVIDEO.LIB"
+    publics: list[str] = field(default_factory=list)
+    externs: list[str] = field(default_factory=list)
+    code: int = 0               # bytes in segments of class ...CODE
+    data: int = 0               # everything else (DATA, CONST, BSS, STACK)
+
+
+@dataclass
+class MapSegment:
+    start: int
+    length: int
+    name: str
+    cls: str
+
+
+# ======================================================================
+# OMF
+# ======================================================================
+
+def _records(data: bytes, start: int = 0):
+    """Yield (offset, type, body) for each record; body excludes checksum."""
+    pos = start
+    while pos + 3 <= len(data):
+        rtype = data[pos]
+        length = int.from_bytes(data[pos + 1:pos + 3], "little")
+        yield pos, rtype, data[pos + 3:pos + 2 + length]
+        pos += 3 + length
+
+
+def _index(body: bytes, i: int) -> tuple[int, int]:
+    """Read an OMF index (1 or 2 bytes)."""
+    if body[i] & 0x80:
+        return ((body[i] & 0x7F) << 8) | body[i + 1], i + 2
+    return body[i], i + 1
+
+
+def _name(body: bytes, i: int) -> tuple[str, int]:
+    """Read a length-prefixed name."""
+    n = body[i]
+    return body[i + 1:i + 1 + n].decode("latin-1"), i + 1 + n
+
+
+def _parse_records(records, origin: str) -> OmfModule | None:
+    """Consume one module's records (THEADR..MODEND)."""
+    mod = None
+    lnames = [""]
+    for _, rtype, body in records:
+        if rtype == THEADR:
+            mod = OmfModule(_name(body, 0)[0], origin)
+        elif mod is None:
+            continue
+        elif rtype == LNAMES:
+            i = 0
+            while i < len(body):
+                name, i = _name(body, i)
+                lnames.append(name)
+        elif rtype in (SEGDEF, SEGDEF32):
+            acbp = body[0]
+            i = 1
+            if (acbp >> 5) == 0:
+                i += 3                          # absolute: frame + offset
+            width = 4 if rtype == SEGDEF32 else 2
+            length = int.from_bytes(body[i:i + width], "little")
+            if acbp & 0x02:
+                length = 1 << (8 * width)       # "big" bit: full 64K
+            i += width
+            _, i = _index(body, i)              # segment name
+            cls_idx, i = _index(body, i)
+            cls = lnames[cls_idx] if cls_idx < len(lnames) else ""
+            if cls.upper().endswith("CODE"):
+                mod.code += length
+            else:
+                mod.data += length
+        elif rtype in (PUBDEF, PUBDEF32):
+            grp, i = _index(body, 0)
+            seg, i = _index(body, i)
+            if grp == 0 and seg == 0:
+                i += 2                          # absolute frame
+            width = 4 if rtype == PUBDEF32 else 2
+            while i < len(body):
+                name, i = _name(body, i)
+                i += width
+                _, i = _index(body, i)          # type
+                mod.publics.append(name)
+        elif rtype == EXTDEF:
+            i = 0
+            while i < len(body):
+                name, i = _name(body, i)
+                _, i = _index(body, i)
+                mod.externs.append(name)
+        elif rtype in (MODEND, MODEND32):
+            return mod
+    return mod
+
+
+def read_object(path: Path) -> OmfModule | None:
+    """Read a single .OBJ."""
+    data = path.read_bytes()
+    return _parse_records(_records(data), path.name.upper())
+
+
+def read_library(path: Path) -> list[OmfModule]:
+    """Read every module of an MS .LIB archive.
+
+    Modules start on page boundaries; the page size is given by the
+    library header record.
+    """
+    data = path.read_bytes()
+    if not data or data[0] != LIBHDR:
+        return []
+    page = int.from_bytes(data[1:3], "little") + 3
+    origin = path.name.upper()
+    modules = []
+    pos = page
+    while pos < len(data) and data[pos] == THEADR:
+        records = _records(data, pos)
+        end = pos
+        body_records = []
+        for off, rtype, body in records:
+            body_records.append((off, rtype, body))
+            end = off + 3 + int.from_bytes(data[off + 1:off + 3], "little")
+            if rtype in (MODEND, MODEND32):
+                break
+        mod = _parse_records(body_records, origin)
+        if mod:
+            modules.append(mod)
+        pos = (end + page - 1) // page * page
+    return modules
+
+
+# ======================================================================
+# Map file
+# ======================================================================
+
+_SEG_RE = re.compile(r"^\s*([0-9A-F]{5})H\s+[0-9A-F]{5}H\s+([0-9A-F]{5})H\s+(\S+)\s+(\S+)",
+                     re.IGNORECASE)
+
+
+def read_map_segments(path: Path) -> list[MapSegment]:
+    """Parse the segment table at the top of a LINK .MAP file."""
+    segments = []
+    for line in path.read_text(errors="replace").splitlines():
+        m = _SEG_RE.match(line)
+        if m:
+            segments.append(MapSegment(int(m.group(1), 16), int(m.group(2), 16),
+                                       m.group(3), m.group(4)))
+    return segments
+
+
+# ======================================================================
+# Link replay and report
+# ======================================================================
+
+def resolve(objects: list[OmfModule],
+            libraries: list[list[OmfModule]]) -> list[OmfModule]:
+    """Return the modules LINK would include, objects first.
+
+    Like LINK, every object is included, then the libraries are searched
+    for undefined symbols, repeatedly, until a pass adds nothing.
+    """
+    linked = list(objects)
+    seen = {id(m) for m in objects}
+    defined = {p for m in objects for p in m.publics}
+    undefined = {e for m in objects for e in m.externs} - defined
+
+    indexes = []
+    for lib in libraries:
+        index = {}
+        for mod in lib:
+            for p in mod.publics:
+                index.setdefault(p, mod)
+        indexes.append(index)
+
+    changed = True
+    while changed and undefined:
+        changed = False
+        for index in indexes:
+            for sym in sorted(undefined):
+                mod = index.get(sym)
+                if mod is None or sym in defined or id(mod) in seen:
+                    continue
+                linked.append(mod)
+                seen.add(id(mod))
+                defined.update(mod.publics)
+                undefined.update(e for e in mod.externs if e not in defined)
+                undefined -= defined
+                changed = True
+    return linked
+
+
+def size_report(objects: list[Path], libraries: list[Path],
+                map_path: Path | None) -> list[str]:
+    """Return report lines attributing linked bytes to modules."""
+    objs = [m for m in (read_object(p) for p in objects if p.exists()) if m]
+    libs = [read_library(p) for p in libraries if p.exists()]
+    linked = resolve(objs, libs)
+    own = {id(m) for m in objs}
+
+    # Which of a library module's publics are referenced by the program
+    refs: dict[str, set[int]] = {}
+    for mod in linked:
+        for e in mod.externs:
+            refs.setdefault(e, set()).add(id(mod))
+
+    lines = [f"  {'module':<14} {'from':<13} {'code':>6} {'data':>6}  pulled in by"]
+    single = []
+    total_code = total_data = 0
+    for mod in linked:
+        total_code += mod.code
+        total_data += mod.data
+        used = [p for p in mod.publics if refs.get(p, set()) - {id(mod)}]
+        why = "" if id(mod) in own else " ".join(used[:3]) + (" ..." if len(used) > 3 else "")
+        lines.append(f"  {mod.name[:14]:<14} {mod.origin:<13} "
+                     f"{mod.code:6} {mod.data:6}  {why}".rstrip())
+        if id(mod) not in own and len(used) == 1:
+            single.append((mod, used[0]))
+    lines.append(f"  {'total':<28} {total_code:6} {total_data:6}")
+
+    if map_path and map_path.exists():
+        segments = read_map_segments(map_path)
+        code = sum(s.length for s in segments if s.cls.upper().endswith("CODE"))
+        data = sum(s.length for s in segments if not s.cls.upper().endswith("CODE"))
+        lines.append(f"  {'linked (' + map_path.name + ')':<28} {code:6} {data:6}")
+
+    if single:
+        lines.append("")
+        lines.append("modules pulled in by a single symbol:")
+        for mod, sym in sorted(single, key=lambda s: -(s[0].code + s[0].data)):
+            lines.append(f"  {mod.name[:14]:<14} {mod.origin:<13} "
+                         f"{mod.code + mod.data:6} bytes  via {sym}")
+
+    missing = [p.name for p in libraries if not p.exists()]
+    if missing:
+        lines.append("")
+        lines.append(f"not inspected (not found): {', '.join(missing)}")
+    return lines
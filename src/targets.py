@@ -5,7 +5,11 @@ import sys
 from abc import ABC, abstractmethod
 from pathlib import Path
 
-from config import ProjectConfig
+import libabi
+import libcache
+import linkmap
+from config import ProjectConfig, LIBS_DIR
+from libbuild import LIB_MODELS, variant_for
 from workspace import SourceFile
 from xt import XTRunner
 
@@ -30,6 +34,9 @@ class Target(ABC):
         self.cfg = cfg
         self.runner = runner
         self.build_dir = build_dir
+        # What the last _link passed to LINK (DOS paths / library names)
+        self.link_objs: list[str] = []
+        self.link_libs: list[str] = []
 
     def build(self, sources: list[SourceFile], project_root: Path) -> Path:
         """Full build pipeline. Returns path to output binary."""
@@ -87,6 +94,23 @@ class Target(ABC):
 
         return dest
 
+    def size_report(self) -> list[str]:
+        """Attribute the linked program's bytes to objects and library modules.
+
+        Must run before the workspace is cleaned up.
+        """
+        lib_dir = self.build_dir / "LIB"
+        # Toolchain libs keep their host-side case; LINK doesn't care
+        by_upper = ({p.name.upper(): p for p in lib_dir.iterdir()}
+                    if lib_dir.exists() else {})
+        libs = []
+        for lib in self.link_libs:
+            name = lib.upper() if lib.upper().endswith(".LIB") else lib.upper() + ".LIB"
+            libs.append(by_upper.get(name, lib_dir / name))
+        objs = [self.build_dir / o.replace("\\", "/") for o in self.link_objs]
+        map_path = self.build_dir / "SRC" / self._output_name(".MAP")
+        return linkmap.size_report(objs, libs, map_path)
+
     def _common_compile_flags(self) -> str:
         """Build common compiler flags from project config."""
         parts = ["/c"]
@@ -150,6 +174,62 @@ class Target(ABC):
             result.append(lib)
         return result
 
+    def lib_model(self) -> str:
+        """Memory model the objects are compiled for (targets may force one)."""
+        return self.cfg.compiler.model
+
+    def linked_libraries(self) -> list[str]:
+        """The [linker] libraries this target actually links."""
+        return list(self.cfg.linker.libraries)
+
+    def fp_mode(self) -> str:
+        """Floating-point mode the project's objects are compiled for."""
+        return libabi.fp_mode(" ".join(self.cfg.compiler.extra_flags))
+
+    def _toolchain_fingerprint(self) -> str | None:
+        bin_dir = self.build_dir / "BIN"
+        if not bin_dir.exists():
+            return None
+        return libcache.toolchain_fingerprint(bin_dir.resolve().parent)
+
+    def _resolve_libs(self, libs: list[str]) -> list[str]:
+        """Map doscc library names to the variant matching the memory model.
+
+        'VIDEO.LIB' becomes 'LVIDEO.LIB' for a large-model build (or the
+        /Ox build 'LVIDEOX.LIB' when optimizing for speed and it exists).
+        Names that aren't doscc libraries pass through unchanged. Each
+        variant's ABI manifest is checked first: a model mismatch raises
+        AbiError, FP mode or toolchain differences only warn.
+        """
+        variant = variant_for(self.lib_model())
+        lib_dir = self.build_dir / "LIB"
+        result = []
+        for lib in libs:
+            stem = lib.upper().rsplit(".", 1)[0]
+            if not (LIBS_DIR / stem.lower()).is_dir():
+                result.append(lib)
+                continue
+
+            candidates = [variant.lib_name(stem)]
+            if self.cfg.compiler.optimization == "speed":
+                candidates.insert(0, variant_for(self.lib_model(), speed=True)
+                                  .lib_name(stem))
+            for cand in candidates:
+                if (lib_dir / cand).exists():
+                    for warning in libabi.check(
+                            LIBS_DIR / stem.lower() / cand, stem,
+                            variant.model,
+                            self.fp_mode(), self._toolchain_fingerprint()):
+                        print(f"warning: {warning}", file=sys.stderr)
+                    result.append(cand)
+                    break
+            else:
+                print(f"warning: {stem} has no {self.lib_model()}-model build "
+                      f"({candidates[-1]}), linking {lib} as-is", file=sys.stderr)
+                print(f"run 'doscc lib build {stem.lower()}'", file=sys.stderr)
+                result.append(lib)
+        return result
+
 
 # ======================================================================
 # DOS EXE target
@@ -158,15 +238,6 @@ class Target(ABC):
 class DosExeTarget(Target):
     """Standard DOS .EXE using MS C runtime."""
 
-    # Memory model prefix for library names (tiny uses small-model libs)
-    MODEL_PREFIX = {
-        "tiny": "S",
-        "small": "S",
-        "medium": "M",
-        "compact": "C",
-        "large": "L",
-    }
-
     def _compile_flags(self) -> str:
         return self._common_compile_flags()
 
@@ -189,7 +260,8 @@ class DosExeTarget(Target):
 
     def _combined_lib(self) -> str:
         """Return the combined CRT+FP library name for the current model and FP mode."""
-        prefix = self.MODEL_PREFIX.get(self.cfg.compiler.model, "S")
+        # MS C names its runtime with the same model letter (SLIBCE.LIB)
+        prefix = LIB_MODELS[variant_for(self.cfg.compiler.model).model]
         suffix = self._detect_fp_suffix()
         return f"{prefix}LIB{suffix}.LIB"
 
@@ -200,14 +272,16 @@ class DosExeTarget(Target):
         map_name = self._output_name(".MAP") if self.cfg.linker.map_file else "NUL"
         map_path = f"SRC\\{map_name}" if self.cfg.linker.map_file else "NUL"
 
-        # Libraries - normalize user libs, add combined CRT+FP lib + helper lib
-        libs = self._normalize_libs(self.cfg.linker.libraries)
+        # Libraries - normalize user libs and pick their model variant,
+        # add combined CRT+FP lib + helper lib
+        libs = self._resolve_libs(self._normalize_libs(self.cfg.linker.libraries))
         combined = self._combined_lib()
         if combined not in libs:
             libs.append(combined)
         if "LIBH.LIB" not in libs:
             libs.append("LIBH.LIB")
         libs_str = "+".join(libs)
+        self.link_objs, self.link_libs = list(obj_files), libs
 
         flags = self._link_flags()
         flags_str = " ".join(flags)
@@ -224,6 +298,12 @@ class DosExeTarget(Target):
 class DosComTarget(Target):
     """DOS .COM (tiny model)."""
 
+    def lib_model(self) -> str:
+        return "tiny"
+
+    def linked_libraries(self) -> list[str]:
+        return []       # _link passes LINK no libraries
+
     def _compile_flags(self) -> str:
         flags = self._common_compile_flags()
         # Force tiny model for .COM
@@ -235,6 +315,7 @@ class DosComTarget(Target):
         com_name = self._output_name(".COM")
         exe_path = f"SRC\\{self._output_name('.EXE')}"
         map_path = "NUL"
+        self.link_objs, self.link_libs = list(obj_files), []
 
         flags = self._link_flags()
         flags_str = " ".join(flags)
@@ -255,6 +336,9 @@ class DosComTarget(Target):
 class HP95LXTarget(Target):
     """HP 95LX .EXM (System Manager compliant)."""
 
+    def lib_model(self) -> str:
+        return "small"
+
     def _compile_flags(self) -> str:
         flags = self._common_compile_flags()
         # Force small model and no stack probes
@@ -273,8 +357,11 @@ class HP95LXTarget(Target):
         # HP 95LX links with CSVC.OBJ and CRT0.OBJ from SDK
         sdk_objs = "TOOLS\\CSVC.OBJ+TOOLS\\CRT0.OBJ"
 
-        normalized = self._normalize_libs(self.cfg.linker.libraries)
+        normalized = self._resolve_libs(
+            self._normalize_libs(self.cfg.linker.libraries))
         libs = "+".join(normalized) if normalized else ""
+        self.link_objs = obj_files + sdk_objs.split("+")
+        self.link_libs = normalized
 
         flags = " ".join(self._link_flags())
         if "/M" not in flags:
@@ -310,6 +397,9 @@ class HP200LXTarget(HP95LXTarget):
 class Win16Target(Target):
     """Windows 3.x 16-bit .EXE."""
 
+    def lib_model(self) -> str:
+        return "small"
+
     def _compile_flags(self) -> str:
         flags = self._common_compile_flags()
         # Force small model and Windows prolog/epilog
@@ -326,11 +416,12 @@ class Win16Target(Target):
         map_path = f"SRC\\{map_name}" if self.cfg.linker.map_file else "NUL"
 
         # Windows libraries
-        libs = list(self.cfg.linker.libraries)
+        libs = self._resolve_libs(list(self.cfg.linker.libraries))
         for default_lib in ["SLIBCEW", "LIBW"]:
             if default_lib not in libs:
                 libs.append(default_lib)
         libs_str = "+".join(libs)
+        self.link_objs, self.link_libs = list(obj_files), libs
 
         # Check for .DEF file
         def_file = ""
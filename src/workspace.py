@@ -129,7 +129,8 @@ class Workspace:
                     if not dest.exists():
                         os.symlink(item, dest)
 
-        # Pre-built library .LIB files
+        # Pre-built library .LIB files - every model variant (SVIDEO.LIB,
+        # LVIDEO.LIB, ...); the target links the one matching its model
         if LIBS_DIR.exists():
             for doscc_lib in LIBS_DIR.iterdir():
                 if doscc_lib.is_dir():